@@ -22,15 +22,20 @@ DEPENDPATH += src \
 INCLUDEPATH += src \
                visualization/headers \
 
-HEADERS += src/graph.h \
+HEADERS += src/coord_traits.h \
+           src/graph.h \
            src/kirkpatrick.h \
+           src/kirkpatrick_handle.h \
+           src/trace.h \
            src/triangle.h \
            src/util.h \
            src/viewer.h
 
 SOURCES += src/graph.cpp \
            src/kirkpatrick.cpp \
+           src/kirkpatrick_handle.cpp \
            src/main.cpp \
+           src/trace.cpp \
            src/triangle.cpp \
            src/viewer.cpp
 
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// Coordinate traits select at compile time how points are stored
+// (coord_type) and in which type orientation predicates are computed
+// (det_type). det_type must hold the difference of two products of
+// coordinate differences exactly for coordinates up to max_coord() by
+// absolute value; the kernel refuses input whose outer triangle exceeds it.
+template<class Coord>
+struct coord_traits;
+
+// Tile coordinates: differences fit in 17 bits, products in 34.
+// The outer triangle is stored in int16_t too, and its corners reach
+// max(x + y) - min(x, y, 0) + 20, so only part of the 16-bit range is usable:
+// input in [0, X] x [0, X] needs X <= 16373. Points are 4 bytes instead of
+// 8, but a hierarchy's memory is dominated by its triangles' shared_ptr and
+// child vectors, so it does not shrink by much.
+template<>
+struct coord_traits<int16_t> {
+   typedef int16_t coord_type;
+   typedef int64_t det_type;
+   static constexpr coord_type max_coord() {
+      return std::numeric_limits<int16_t>::max();
+   }
+};
+
+template<>
+struct coord_traits<int32_t> {
+   typedef int32_t coord_type;
+   typedef __int128 det_type;
+   static constexpr coord_type max_coord() {
+      return std::numeric_limits<int32_t>::max();
+   }
+};
+
+// Differences of coordinates below 2^62 fit in 63 bits, products in 126.
+template<>
+struct coord_traits<int64_t> {
+   typedef int64_t coord_type;
+   typedef __int128 det_type;
+   static constexpr coord_type max_coord() { return (int64_t(1) << 62) - 1; }
+};
+
+// Not exact, but long double keeps a few more bits than the inputs.
+template<>
+struct coord_traits<double> {
+   typedef double coord_type;
+   typedef long double det_type;
+   static constexpr coord_type max_coord() {
+      return std::numeric_limits<double>::max();
+   }
+};
+
+// Every structure templated on coordinate traits is explicitly instantiated
+// for the traits above in its translation unit.
+#define INSTANTIATE_FOR_COORD_TRAITS(tmpl) \
+   template struct tmpl<coord_traits<int16_t> >; \
+   template struct tmpl<coord_traits<int32_t> >; \
+   template struct tmpl<coord_traits<int64_t> >; \
+   template struct tmpl<coord_traits<double> >;
+
+template<class Traits>
+struct basic_point {
+   typedef typename Traits::coord_type coord_type;
+   basic_point(): x(), y() { }
+   basic_point(coord_type x, coord_type y): x(x), y(y) { }
+   coord_type x;
+   coord_type y;
+};
+
+template<class Traits>
+bool operator==(basic_point<Traits> const& p1, basic_point<Traits> const& p2) {
+   return p1.x == p2.x && p1.y == p2.y;
+}
+
+template<class Traits>
+bool operator!=(basic_point<Traits> const& p1, basic_point<Traits> const& p2) {
+   return !(p1 == p2);
+}
+
+template<class Traits>
+bool operator<(basic_point<Traits> const& p1, basic_point<Traits> const& p2) {
+   return p1.x < p2.x || (p1.x == p2.x && p1.y < p2.y);
+}
+
+template<class Traits>
+std::ostream& operator<<(std::ostream& ost, basic_point<Traits> const& p) {
+   return ost << "(" << p.x << ", " << p.y << ")";
+}
+
+template<class Traits>
+struct basic_segment {
+   basic_segment(basic_point<Traits> const& p1, basic_point<Traits> const& p2) {
+      _points[0] = p1;
+      _points[1] = p2;
+   }
+   basic_point<Traits> const& operator[](size_t i) const { return _points[i]; }
+private:
+   basic_point<Traits> _points[2];
+};
+
+template<class Traits>
+std::ostream& operator<<(std::ostream& ost, basic_segment<Traits> const& s) {
+   return ost << "[" << s[0] << ", " << s[1] << "]";
+}
+
+template<class Traits>
+using point_arr = std::vector<basic_point<Traits> >;
+
+template<class Traits>
+using segment_arr = std::vector<basic_segment<Traits> >;
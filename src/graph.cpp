@@ -1,17 +1,22 @@
+#include <stdexcept>
+
 #include "graph.h"
 
-graph_type::graph_type(point_arr const& special_points):
+template<class Traits>
+graph_type<Traits>::graph_type(point_arr<Traits> const& special_points):
    _special_points(special_points) {
    add_poly(special_points);
 }
 
-void graph_type::add(point_type const& p) {
-   logger << "Adding point " << p << std::endl;
+template<class Traits>
+void graph_type<Traits>::add(point_type const& p) {
+   TRACE(graph, verbose, "Adding point " << p);
    _graph[p] = std::set<point_type>();
 }
 
-void graph_type::add_edge(point_type const& p1, point_type const& p2) {
-   logger << "Adding edge " << p1 << " <-> " << p2 << std::endl;
+template<class Traits>
+void graph_type<Traits>::add_edge(point_type const& p1, point_type const& p2) {
+   TRACE(graph, verbose, "Adding edge " << p1 << " <-> " << p2);
    if(_graph.find(p1) == _graph.end())
       throw std::logic_error("first point is not in graph");
    if(_graph.find(p2) == _graph.end())
@@ -20,7 +25,8 @@ void graph_type::add_edge(point_type const& p1, point_type const& p2) {
    _graph[p2].insert(p1);
 }
 
-void graph_type::add_poly(point_arr const& points) {
+template<class Traits>
+void graph_type<Traits>::add_poly(point_arr<Traits> const& points) {
    auto fst_point = points.begin();
    add(*fst_point);
    auto prev = fst_point;
@@ -31,8 +37,9 @@ void graph_type::add_poly(point_arr const& points) {
    add_edge(*prev, *fst_point);
 }
 
-segment_arr graph_type::edges() const {
-   segment_arr res;
+template<class Traits>
+segment_arr<Traits> graph_type<Traits>::edges() const {
+   segment_arr<Traits> res;
    for(auto el: _graph) {
       auto p1 = el.first;
       for(auto p2: el.second) {
@@ -43,8 +50,9 @@ segment_arr graph_type::edges() const {
    return res;
 }
 
-point_arr graph_type::independent_set(size_t max_degree) const {
-   point_arr res;
+template<class Traits>
+point_arr<Traits> graph_type<Traits>::independent_set(size_t max_degree) const {
+   point_arr<Traits> res;
    std::set<point_type> masked;
    for(auto pt: _special_points) masked.insert(pt);
    for(auto el: _graph) {
@@ -56,13 +64,17 @@ point_arr graph_type::independent_set(size_t max_degree) const {
    return res;
 }
 
-void graph_type::remove(point_type const& pt) {
+template<class Traits>
+void graph_type<Traits>::remove(point_type const& pt) {
    for(auto el: _graph[pt]) {
       _graph[el].erase(pt);
    }
    _graph.erase(pt);
 }
 
-void graph_type::remove(point_arr const& pts) {
+template<class Traits>
+void graph_type<Traits>::remove(point_arr<Traits> const& pts) {
    for(auto pt: pts) remove(pt);
 }
+
+INSTANTIATE_FOR_COORD_TRAITS(graph_type)
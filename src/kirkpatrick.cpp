@@ -1,78 +1,106 @@
-#include <algorithm> // for std::max in "geom/primitives/vector.h"
-#include "geom/primitives/vector.h"
-#include "visualization/viewer_adapter.h"
+#include <array>
+#include <stdexcept>
 
-using geom::structures::vector_type;
+#include "geom/primitives/point.h"
+#include "visualization/viewer_adapter.h"
 
 #include "kirkpatrick.h"
 #include "triangle.h"
 
 const size_t MAX_DEGREE = 8;
 
-typedef std::set<std::shared_ptr<triangle_type> > triangle_set;
+template<class Traits>
+using triangle_ptr = std::shared_ptr<triangle_type<Traits> >;
+
+template<class Traits>
+using triangle_set = std::set<triangle_ptr<Traits> >;
 
-std::ostream& operator<<(std::ostream& ost, triangle_set const& triangles) {
+template<class Traits>
+std::ostream& operator<<(std::ostream& ost, triangle_set<Traits> const& triangles) {
    for(auto i: triangles) {
       ost << "   " << *i << std::endl;
    }
    return ost;
 }
 
-typedef std::map<point_type, triangle_set> triangle_map;
+template<class Traits>
+using triangle_map = std::map<basic_point<Traits>, triangle_set<Traits> >;
 
-std::ostream& operator<<(std::ostream& ost, triangle_map const& triangles) {
+template<class Traits>
+std::ostream& operator<<(std::ostream& ost, triangle_map<Traits> const& triangles) {
    for(auto i: triangles) {
       ost << i.first << ":" << std::endl << i.second;
    }
    return ost;
 }
 
-void add_triangle(graph_type& graph, point_type const& p1, point_type const& p2,
-      point_type const& p3, bool is_inside, triangle_map& triangles,
-      triangle_set& generated_triangles) {
-   logger << "Adding triangle " << p1 << " " << p2 << " " << p3 << std::endl;
+template<class Traits>
+triangle_ptr<Traits> add_triangle(graph_type<Traits>& graph, basic_point<Traits> const& p1,
+      basic_point<Traits> const& p2, basic_point<Traits> const& p3, bool is_inside,
+      triangle_map<Traits>& triangles) {
+   TRACE(build, debug, "Adding triangle " << p1 << " " << p2 << " " << p3);
    graph.add_edge(p1, p2);
    graph.add_edge(p2, p3);
    graph.add_edge(p3, p1);
-   auto t = std::make_shared<triangle_type>(p1, p2, p3, is_inside);
+   auto t = std::make_shared<triangle_type<Traits> >(p1, p2, p3, is_inside);
    triangles[p1].insert(t);
    triangles[p2].insert(t);
    triangles[p3].insert(t);
-   generated_triangles.insert(t);
+   return t;
 }
 
-// Ear clipping.
-void triangulate_polygon(point_arr const& points, graph_type& graph,
-      triangle_map& triangles, bool is_inside,
-      triangle_set& generated_triangles) {
-   point_arr avail_points;
-   for(auto pt: points) {
-      while(avail_points.size() > 1) {
-         auto jt = avail_points.rbegin();
-         if(!is_ear(*(jt + 1), *jt, pt, points)) break;
-         logger << *(jt + 1) << *jt << pt << " is an ear" << std::endl;
-         add_triangle(graph, *(jt + 1), *jt, pt, is_inside, triangles,
-               generated_triangles);
-         avail_points.pop_back();
+// Ear clipping over a cyclic list of the vertices left. Points have to be
+// counter-clockwise.
+template<class Traits>
+void triangulate_polygon(point_arr<Traits> const& points, graph_type<Traits>& graph,
+      triangle_map<Traits>& triangles, bool is_inside) {
+   size_t left = points.size();
+   std::vector<size_t> prev(left), next(left);
+   for(size_t i = 0; i != left; ++i) {
+      prev[i] = (i + left - 1) % left;
+      next[i] = (i + 1) % left;
+   }
+   size_t cur = 0;
+   size_t failed = 0;
+   while(left > 3) {
+      auto const& p1 = points[prev[cur]];
+      auto const& p2 = points[cur];
+      auto const& p3 = points[next[cur]];
+      bool is_ear = is_left_turn(p1, p2, p3);
+      for(size_t j = next[next[cur]]; j != prev[cur] && is_ear; j = next[j]) {
+         if(points[j] == p1 || points[j] == p2 || points[j] == p3) continue;
+         if(inside_triangle(p1, p2, p3, points[j])) is_ear = false;
+      }
+      if(!is_ear) {
+         if(++failed > left) throw std::logic_error("polygon has no ear");
+         cur = next[cur];
+         continue;
       }
-      logger << "Adding " << pt << " to avail_points" << std::endl;
-      avail_points.push_back(pt);
+      TRACE(build, debug, p1 << p2 << p3 << " is an ear");
+      add_triangle(graph, p1, p2, p3, is_inside, triangles);
+      next[prev[cur]] = next[cur];
+      prev[next[cur]] = prev[cur];
+      cur = prev[cur];
+      failed = 0;
+      --left;
    }
+   add_triangle(graph, points[prev[cur]], points[cur], points[next[cur]], is_inside,
+         triangles);
 }
 
-void triangulate_pockets(point_arr const& points, graph_type& graph,
-      point_arr& convex_hull, triangle_map& triangles) {
-   triangle_set tmp;
+template<class Traits>
+void triangulate_pockets(point_arr<Traits> const& points, graph_type<Traits>& graph,
+      point_arr<Traits>& convex_hull, triangle_map<Traits>& triangles) {
    size_t leftmost = 0;
    for(size_t i = 0; i != points.size(); ++i) {
       if(points[i].x < points[leftmost].x) leftmost = i;
    }
-   logger << points[leftmost] << " is the leftmost" << std::endl;
+   TRACE(build, debug, points[leftmost] << " is the leftmost");
    size_t i = leftmost;
    convex_hull.push_back(points[(i++) % points.size()]);
-   logger << "Pushing " << convex_hull.back() << " to convex_hull" << std::endl;
+   TRACE(build, debug, "Pushing " << convex_hull.back() << " to convex_hull");
    convex_hull.push_back(points[(i++) % points.size()]);
-   logger << "Pushing " << convex_hull.back() << " to convex_hull" << std::endl;
+   TRACE(build, debug, "Pushing " << convex_hull.back() << " to convex_hull");
    for(; i - leftmost != points.size() + 1; ++i) {
       auto pt = points[i % points.size()];
       while(convex_hull.size() > 1) {
@@ -84,154 +112,259 @@ void triangulate_pockets(point_arr const& points, graph_type& graph,
             if(inside_triangle(pt, *jt, *(jt + 1), p)) { res = false; break; }
          }
          if(!res) break;
-         logger << pt << *jt << *(jt + 1) << " is a pocket" << std::endl;
-         add_triangle(graph, pt, *jt, *(jt + 1), false, triangles, tmp);
-         logger << "Popping " << convex_hull.back() << " from convex_hull" << std::endl;
+         TRACE(build, debug, pt << *jt << *(jt + 1) << " is a pocket");
+         add_triangle(graph, pt, *jt, *(jt + 1), false, triangles);
+         TRACE(build, debug, "Popping " << convex_hull.back() << " from convex_hull");
          convex_hull.pop_back();
       }
       convex_hull.push_back(pt);
-      logger << "Pushing " << pt << " to convex_hull" << std::endl;
+      TRACE(build, debug, "Pushing " << pt << " to convex_hull");
    }
 }
 
 // convex_hull and outer_points are counter-clockwise
-void triangulate_with_outer_triangle(point_arr const& convex_hull,
-      point_arr const& outer_points, graph_type& graph, triangle_map& triangles) {
-   triangle_set tmp;
+template<class Traits>
+void triangulate_with_outer_triangle(point_arr<Traits> const& convex_hull,
+      point_arr<Traits> const& outer_points, graph_type<Traits>& graph,
+      triangle_map<Traits>& triangles) {
    // First point on convex_hull is leftmost.
    // Therefore it sees first and last out of outer_points.
    add_triangle(graph, convex_hull[0], outer_points[2], outer_points[0], false,
-         triangles, tmp);
+         triangles);
    size_t last_seen = 0;
    for(size_t i = 1; i != convex_hull.size(); ++i) {
-      logger << "Looking at " << convex_hull[i] << std::endl;
+      TRACE(build, debug, "Looking at " << convex_hull[i]);
       if(is_left_turn(outer_points[last_seen], convex_hull[i], convex_hull[i - 1])) {
-         logger << "It sees " << last_seen << std::endl;
+         TRACE(build, debug, "It sees " << last_seen);
          add_triangle(graph, convex_hull[i - 1], outer_points[last_seen], convex_hull[i],
-               false, triangles, tmp);
+               false, triangles);
       }
       if(last_seen == 2) continue;
       if(is_right_turn(outer_points[last_seen + 1], convex_hull[i], convex_hull[i + 1])) {
-         logger << "And it sees " << last_seen + 1 << std::endl;
+         TRACE(build, debug, "And it sees " << last_seen + 1);
          add_triangle(graph, outer_points[last_seen], outer_points[last_seen + 1],
-            convex_hull[i], false, triangles, tmp);
+            convex_hull[i], false, triangles);
          last_seen += 1;
       }
    }
 }
 
-void initial_triangulation(point_arr const& points, point_arr const& outer_points,
-      graph_type& graph, triangle_map& triangles) {
-   logger << "Triangulating polygon" << std::endl;
-   triangle_set tris;
-   triangulate_polygon(points, graph, triangles, true, tris);
-   point_arr convex_hull;
-   logger << "Triangulating pockets" << std::endl;
+template<class Traits>
+void initial_triangulation(point_arr<Traits> const& points,
+      point_arr<Traits> const& outer_points, graph_type<Traits>& graph,
+      triangle_map<Traits>& triangles) {
+   TRACE_SCOPE(build, info, "initial triangulation");
+   TRACE(build, info, "Triangulating polygon");
+   triangulate_polygon(points, graph, triangles, true);
+   point_arr<Traits> convex_hull;
+   TRACE(build, info, "Triangulating pockets");
    triangulate_pockets(points, graph, convex_hull, triangles);
-   logger << "Triangulating with outer triangle" << std::endl;
+   TRACE(build, info, "Triangulating with outer triangle");
    triangulate_with_outer_triangle(convex_hull, outer_points, graph, triangles);
 }
 
 
-void retriangulate(point_arr& poly, point_type const& pt,
-      graph_type& graph, triangle_map& triangles) {
-   triangle_set const& old_triangles = triangles[pt];
-   logger << "Retriangulation for " << pt << ". Old set: " << std::endl;
-   logger << old_triangles << std::endl;
-   triangle_set new_triangles;
-   triangulate_polygon(poly, graph, triangles, false, new_triangles);
-   logger << "New set " << std::endl << new_triangles << std::endl;
-   for(auto ot: old_triangles) {
-      for(auto nt: new_triangles) {
-         if(intersects(*ot, *nt)) {
-            nt->add_child(ot);
-            logger << "Intersection between " << *ot << " and " << *nt << std::endl;
+// Neighbours of a vertex about to be removed, counter-clockwise around it.
+// Its degree is at most MAX_DEGREE, so the star lives on the stack.
+template<class Traits>
+struct star_type {
+   basic_point<Traits> const* begin() const { return points.data(); }
+   basic_point<Traits> const* end() const { return points.data() + size; }
+
+   std::array<basic_point<Traits>, MAX_DEGREE> points;
+   size_t size;
+};
+
+// Insertion sort straight out of the graph's neighbour set.
+template<class Traits>
+void extract_star(graph_type<Traits> const& graph, basic_point<Traits> const& pt,
+      star_type<Traits>& star) {
+   auto const& neighbours = graph.neighbours(pt);
+   if(neighbours.size() > MAX_DEGREE)
+      throw std::logic_error("star is larger than MAX_DEGREE");
+   star.size = 0;
+   for(auto const& p: neighbours) {
+      size_t i = star.size++;
+      for(; i != 0 && counter_clockwise_less(pt, p, star.points[i - 1]); --i)
+         star.points[i] = star.points[i - 1];
+      star.points[i] = p;
+   }
+}
+
+// Ear clipping of the star polygon. Returns the number of triangles.
+template<class Traits>
+size_t triangulate_star(star_type<Traits> const& star, graph_type<Traits>& graph,
+      triangle_map<Traits>& triangles,
+      std::array<triangle_ptr<Traits>, MAX_DEGREE - 2>& generated_triangles) {
+   std::array<size_t, MAX_DEGREE> rest;
+   size_t n = star.size;
+   // Only a hole in the triangulation leaves a vertex with fewer neighbours.
+   if(n < 3) throw std::logic_error("star polygon has no ear");
+   for(size_t i = 0; i != n; ++i) rest[i] = i;
+   size_t count = 0;
+   while(n > 3) {
+      size_t i = 0;
+      for(; i != n; ++i) {
+         auto const& p1 = star.points[rest[(i + n - 1) % n]];
+         auto const& p2 = star.points[rest[i]];
+         auto const& p3 = star.points[rest[(i + 1) % n]];
+         if(!is_left_turn(p1, p2, p3)) continue;
+         bool is_ear = true;
+         for(size_t j = 0; j != n && is_ear; ++j) {
+            auto const& pt = star.points[rest[j]];
+            if(pt == p1 || pt == p2 || pt == p3) continue;
+            if(inside_triangle(p1, p2, p3, pt)) is_ear = false;
          }
+         if(is_ear) break;
       }
-      for(auto& el: triangles) {
-         logger << "Erasing " << *ot << " from " << el.first << std::endl;
-         size_t res = el.second.erase(ot);
-         logger << "Erased " << res << std::endl;
-      }
+      if(i == n) throw std::logic_error("star polygon has no ear");
+      TRACE(build, debug, star.points[rest[i]] << " is an ear");
+      generated_triangles[count++] = add_triangle(graph, star.points[rest[(i + n - 1) % n]],
+            star.points[rest[i]], star.points[rest[(i + 1) % n]], false, triangles);
+      std::copy(rest.begin() + i + 1, rest.begin() + n, rest.begin() + i);
+      --n;
    }
+   generated_triangles[count++] = add_triangle(graph, star.points[rest[0]],
+         star.points[rest[1]], star.points[rest[2]], false, triangles);
+   return count;
+}
+
+template<class Traits>
+void retriangulate(star_type<Traits> const& star, basic_point<Traits> const& pt,
+      graph_type<Traits>& graph, triangle_map<Traits>& triangles) {
+   TRACE_SCOPE(build, debug, "retriangulate");
+   // Detached first: erasing old triangles below must not touch this set.
+   triangle_set<Traits> old_triangles;
+   old_triangles.swap(triangles[pt]);
    triangles.erase(pt);
+   TRACE(build, debug, "Retriangulation for " << pt);
+   TRACE(build, verbose, "Old set: " << std::endl << old_triangles);
+   std::array<triangle_ptr<Traits>, MAX_DEGREE - 2> new_triangles;
+   size_t new_count = triangulate_star(star, graph, triangles, new_triangles);
+   for(auto const& ot: old_triangles) {
+      for(size_t i = 0; i != new_count; ++i) {
+         if(intersects(*ot, *new_triangles[i])) {
+            new_triangles[i]->add_child(ot);
+            TRACE(build, verbose, "Intersection between " << *ot << " and "
+                  << *new_triangles[i]);
+         }
+      }
+      // Only vertices of a triangle refer to it.
+      for(auto const& p: { ot->p1(), ot->p2(), ot->p3() }) {
+         auto it = triangles.find(p);
+         if(it == triangles.end()) continue;
+         TRACE(build, verbose, "Erasing " << *ot << " from " << p);
+         it->second.erase(ot);
+      }
+   }
 }
 
 
-bool refine(graph_type& graph, triangle_map& triangles) {
-   point_arr iset = graph.independent_set(MAX_DEGREE);
+template<class Traits>
+bool refine(graph_type<Traits>& graph, triangle_map<Traits>& triangles) {
+   TRACE_SCOPE(build, info, "refine");
+   point_arr<Traits> iset = graph.independent_set(MAX_DEGREE);
    if(iset.empty()) return false;
-   logger << "Found independent set of size " << iset.size() << std::endl;
+   TRACE(build, info, "Found independent set of size " << iset.size());
+   TRACE_COUNTER(build, info, "independent set", iset.size());
+   TRACE_COUNTER(build, info, "vertices", triangles.size());
    for(auto pt: iset) {
-      logger << "Working on " << pt << std::endl;
-      point_arr poly = sort_counter_clockwise(pt, graph.neighbours(pt));
-      logger << "Neighbours: ";
-      for(auto p: poly) {
-         logger << p << " ";
-      }
-      logger << std::endl;
-      retriangulate(poly, pt, graph, triangles);
+      TRACE(build, debug, "Working on " << pt);
+      star_type<Traits> star;
+      extract_star(graph, pt, star);
+      TRACE(build, debug, "Neighbours: " << trace::join(star));
+      retriangulate(star, pt, graph, triangles);
    }
    graph.remove(iset);
-   logger << "Removed independent set" << std::endl;
+   TRACE(build, info, "Removed independent set");
    return true;
 }
 
-std::shared_ptr<triangle_type> refinement(graph_type& graph, triangle_map& triangles,
-      point_arr const& special_points) {
+template<class Traits>
+std::shared_ptr<triangle_type<Traits> > refinement(graph_type<Traits>& graph,
+      triangle_map<Traits>& triangles, point_arr<Traits> const& special_points) {
    for(;;) {
       if(!refine(graph, triangles)) break;
    }
    return *(triangles.begin()->second.begin());
 }
 
-point_arr find_outer_triangle(point_arr const& points) {
-   point_arr res;
-   point_type lower_left;
-   int32_t c = 0;
+// The outer triangle encloses the input, so bounding its corners by
+// max_coord() keeps every determinant exact. Input needs some headroom.
+template<class Traits>
+typename Traits::coord_type outer_coord(typename Traits::det_type c) {
+   typedef typename Traits::coord_type coord_type;
+   if(c < -Traits::max_coord() || c > Traits::max_coord())
+      throw std::range_error("outer triangle does not fit into coordinate range");
+   return coord_type(c);
+}
+
+template<class Traits>
+point_arr<Traits> find_outer_triangle(point_arr<Traits> const& points) {
+   typedef typename Traits::det_type det_type;
+   point_arr<Traits> res;
+   det_type lower_x = 0;
+   det_type lower_y = 0;
+   det_type c = 0;
    for(auto pt: points) {
-      if(pt.x < lower_left.x) lower_left.x = pt.x;
-      if(pt.y < lower_left.y) lower_left.y = pt.y;
-      if(pt.x + pt.y > c) c = pt.x + pt.y;
+      if(pt.x < lower_x) lower_x = pt.x;
+      if(pt.y < lower_y) lower_y = pt.y;
+      if(det_type(pt.x) + pt.y > c) c = det_type(pt.x) + pt.y;
    }
-   lower_left += vector_type(-10,-10);
+   lower_x -= 10;
+   lower_y -= 10;
    c += 10;
-   res.push_back(lower_left);
-   res.push_back(point_type(c - lower_left.y, lower_left.y));
-   res.push_back(point_type(lower_left.x, c - lower_left.x));
+   res.push_back(basic_point<Traits>(outer_coord<Traits>(lower_x),
+            outer_coord<Traits>(lower_y)));
+   res.push_back(basic_point<Traits>(outer_coord<Traits>(c - lower_y),
+            outer_coord<Traits>(lower_y)));
+   res.push_back(basic_point<Traits>(outer_coord<Traits>(lower_x),
+            outer_coord<Traits>(c - lower_x)));
    return res;
 }
 
-kirkpatrick_type::kirkpatrick_type(point_arr const& points):
+template<class Traits>
+kirkpatrick_type<Traits>::kirkpatrick_type(point_arr<Traits> const& points):
    _outer_points(find_outer_triangle(points)),
    _graph(_outer_points) {
-   logger << "Starting kirkpatrick" << std::endl;
+   TRACE_SCOPE(build, info, "kirkpatrick");
+   TRACE(build, info, "Starting kirkpatrick");
    _graph.add_poly(points);
-   logger << "Bootstrapped graph: " << std::endl << _graph << std::endl;
+   TRACE(build, verbose, "Bootstrapped graph: " << std::endl << _graph);
 
-   point_arr points_copy = points;
+   point_arr<Traits> points_copy = points;
    if(!is_counter_clockwise(points)) {
-      logger << "Polygon was clockwise" << std::endl;
+      TRACE(build, debug, "Polygon was clockwise");
       std::reverse_copy(points.begin(), points.end(), points_copy.begin());
    }
 
-   triangle_map triangles;
+   triangle_map<Traits> triangles;
    initial_triangulation(points_copy, _outer_points, _graph, triangles);
-   logger << "Triangulated graph: " << std::endl << _graph << std::endl;
+   TRACE(build, verbose, "Triangulated graph: " << std::endl << _graph);
    _triangulation = _graph.edges();
-   logger << triangles << std::endl;
+   TRACE(build, verbose, triangles);
    _top_triangle = refinement(_graph, triangles, _outer_points);
 
-   logger << "Got top triangle" << std::endl;
+   TRACE(build, info, "Got top triangle");
 }
 
-bool kirkpatrick_type::query(point_type const& pt) const {
+template<class Traits>
+bool kirkpatrick_type<Traits>::query(point_type const& pt) const {
+   TRACE_SCOPE(query, debug, "query");
    return _top_triangle->query(pt);
 }
 
-void kirkpatrick_type::draw(visualization::drawer_type& drawer) const {
+template<class Traits>
+geom::structures::point_type to_geom(basic_point<Traits> const& pt) {
+   return geom::structures::point_type(pt.x, pt.y);
+}
+
+template<class Traits>
+void kirkpatrick_type<Traits>::draw(visualization::drawer_type& drawer) const {
    drawer.set_color(Qt::gray);
    for(auto segm: _triangulation) {
-      drawer.draw_line(segm[0], segm[1], 1);
+      drawer.draw_line(to_geom(segm[0]), to_geom(segm[1]), 1);
    }
 }
+
+INSTANTIATE_FOR_COORD_TRAITS(kirkpatrick_type)
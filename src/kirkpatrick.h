@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "graph.h"
 #include "util.h"
 
@@ -9,15 +11,19 @@ namespace visualization {
 
 using visualization::drawer_type;
 
+template<class Traits>
 struct triangle_type;
 
+template<class Traits>
 struct kirkpatrick_type {
-   kirkpatrick_type(point_arr const&);
+   typedef basic_point<Traits> point_type;
+
+   kirkpatrick_type(point_arr<Traits> const&);
    bool query(point_type const&) const;
    void draw(drawer_type& drawer) const;
 private:
-   point_arr _outer_points;
-   graph_type _graph;
-   std::shared_ptr<triangle_type> _top_triangle;
-   std::vector<segment_type> _triangulation;
+   point_arr<Traits> _outer_points;
+   graph_type<Traits> _graph;
+   std::shared_ptr<triangle_type<Traits> > _top_triangle;
+   segment_arr<Traits> _triangulation;
 };
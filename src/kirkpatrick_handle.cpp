@@ -0,0 +1,143 @@
+#include <functional>
+
+#include "kirkpatrick_handle.h"
+
+// All atomic operations below are sequentially consistent. A reader
+// announces the epoch it read before loading _current, and a writer bumps
+// the epoch only after swapping _current. So a reader announced with an epoch
+// newer than the one a snapshot was retired in has loaded a newer snapshot.
+
+template<class Traits>
+constexpr std::chrono::milliseconds kirkpatrick_handle<Traits>::RECLAIM_PERIOD;
+
+template<class Traits>
+kirkpatrick_handle<Traits>::kirkpatrick_handle():
+   _current(nullptr), _epoch(1), _retired_pending(false), _overflow_slots(nullptr),
+   _stopping(false),
+   _reclaimer(&kirkpatrick_handle::reclaim_loop, this) { }
+
+template<class Traits>
+kirkpatrick_handle<Traits>::~kirkpatrick_handle() {
+   {
+      std::lock_guard<std::mutex> lock(_reclaim_mutex);
+      _stopping.store(true);
+   }
+   _reclaim_cv.notify_one();
+   _reclaimer.join();
+   delete _current.load();
+   for(auto el: _retired) delete el.second;
+   for(overflow_slot* slot = _overflow_slots.load(); slot; ) {
+      overflow_slot* next = slot->next;
+      delete slot;
+      slot = next;
+   }
+}
+
+// An epoch read before claiming a slot may be stale by then. That is safe:
+// an older epoch only keeps more snapshots alive.
+template<class Traits>
+std::atomic<uint64_t>& kirkpatrick_handle<Traits>::enter() const {
+   uint64_t epoch = _epoch.load();
+   size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % READER_SLOTS;
+   for(size_t i = 0; i != READER_SLOTS; ++i) {
+      reader_slot& slot = _slots[(start + i) % READER_SLOTS];
+      uint64_t free = 0;
+      if(slot.epoch.compare_exchange_strong(free, epoch)) return slot.epoch;
+   }
+   for(overflow_slot* slot = _overflow_slots.load(); slot; slot = slot->next) {
+      uint64_t free = 0;
+      if(slot->epoch.compare_exchange_strong(free, epoch)) return slot->epoch;
+   }
+   // Announced before it becomes visible to writers, like a claimed slot.
+   overflow_slot* slot = new overflow_slot;
+   slot->epoch.store(epoch);
+   slot->next = _overflow_slots.load();
+   while(!_overflow_slots.compare_exchange_weak(slot->next, slot)) { }
+   return slot->epoch;
+}
+
+template<class Traits>
+kirkpatrick_handle<Traits>::read_guard::read_guard(kirkpatrick_handle const& handle):
+   _slot(handle.enter()), _snapshot(handle._current.load()) { }
+
+// publish sets _retired_pending before it takes _reclaim_mutex to notify,
+// so the wake-up cannot be lost between the check and the wait.
+template<class Traits>
+void kirkpatrick_handle<Traits>::reclaim_loop() {
+   std::unique_lock<std::mutex> lock(_reclaim_mutex);
+   for(;;) {
+      _reclaim_cv.wait(lock, [this] {
+         return _stopping.load() || _retired_pending.load();
+      });
+      if(_stopping.load()) return;
+      // Give the readers of the retired snapshots time to leave.
+      if(_reclaim_cv.wait_for(lock, RECLAIM_PERIOD, [this] { return _stopping.load(); }))
+         return;
+      lock.unlock();
+      reclaim();
+      lock.lock();
+   }
+}
+
+template<class Traits>
+bool kirkpatrick_handle<Traits>::query(point_type const& pt) const {
+   read_guard guard(*this);
+   return guard.snapshot() && guard.snapshot()->query(pt);
+}
+
+template<class Traits>
+void kirkpatrick_handle<Traits>::rebuild(point_arr<Traits> const& points) {
+   TRACE_SCOPE(build, info, "rebuild");
+   publish(std::unique_ptr<snapshot_type>(new snapshot_type(points)));
+}
+
+template<class Traits>
+void kirkpatrick_handle<Traits>::publish(std::unique_ptr<snapshot_type> snapshot) {
+   std::vector<snapshot_type*> garbage;
+   {
+      std::lock_guard<std::mutex> lock(_write_mutex);
+      snapshot_type* old = _current.exchange(snapshot.release());
+      uint64_t epoch = _epoch.fetch_add(1);
+      if(old) _retired.push_back(std::make_pair(epoch, old));
+      collect_locked(garbage);
+   }
+   if(_retired_pending.load()) {
+      std::lock_guard<std::mutex> lock(_reclaim_mutex);
+      _reclaim_cv.notify_one();
+   }
+   for(auto s: garbage) delete s;
+}
+
+template<class Traits>
+void kirkpatrick_handle<Traits>::reclaim() {
+   std::vector<snapshot_type*> garbage;
+   {
+      std::lock_guard<std::mutex> lock(_write_mutex);
+      collect_locked(garbage);
+   }
+   for(auto s: garbage) delete s;
+}
+
+template<class Traits>
+void kirkpatrick_handle<Traits>::collect_locked(std::vector<snapshot_type*>& garbage) {
+   if(!_retired.empty()) {
+      uint64_t oldest = _epoch.load();
+      auto visit = [&oldest](std::atomic<uint64_t> const& slot) {
+         uint64_t epoch = slot.load();
+         if(epoch != 0 && epoch < oldest) oldest = epoch;
+      };
+      for(auto const& slot: _slots) visit(slot.epoch);
+      for(overflow_slot* slot = _overflow_slots.load(); slot; slot = slot->next)
+         visit(slot->epoch);
+      auto it = std::partition(_retired.begin(), _retired.end(),
+            [oldest](std::pair<uint64_t, snapshot_type*> const& el) {
+               return el.first >= oldest;
+      });
+      TRACE_COUNTER(build, debug, "reclaimed snapshots", _retired.end() - it);
+      for(auto jt = it; jt != _retired.end(); ++jt) garbage.push_back(jt->second);
+      _retired.erase(it, _retired.end());
+   }
+   _retired_pending.store(!_retired.empty());
+}
+
+INSTANTIATE_FOR_COORD_TRAITS(kirkpatrick_handle)
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "kirkpatrick.h"
+
+// Serves queries from many threads without locks while another thread
+// rebuilds the hierarchy. A new snapshot is published by swapping an atomic
+// pointer. The old one is retired and deleted once no reader that could have
+// seen it is still inside a read-side critical section (epoch-based
+// reclamation). Entering and leaving is one compare-and-swap and one store
+// on a reader slot; readers never block on writers and never delete
+// anything. The handle's reclaimer thread sleeps until publish retires a
+// snapshot, then rescans the slots every RECLAIM_PERIOD until every retired
+// snapshot is deleted.
+//
+// The first READER_SLOTS concurrent readers use preallocated slots. Readers
+// beyond that get overflow slots, which are allocated once and reused until
+// the handle is destroyed, so a reader never waits for another one to leave.
+template<class Traits>
+struct kirkpatrick_handle {
+   typedef kirkpatrick_type<Traits> snapshot_type;
+   typedef basic_point<Traits> point_type;
+
+   kirkpatrick_handle();
+   // There must be no readers left.
+   ~kirkpatrick_handle();
+   kirkpatrick_handle(kirkpatrick_handle const&) = delete;
+   kirkpatrick_handle& operator=(kirkpatrick_handle const&) = delete;
+
+   // false if nothing is published.
+   bool query(point_type const&) const;
+   // Calls f with the current snapshot (nullptr if nothing is published).
+   // The snapshot must not be used after f returns.
+   template<class F>
+   void read(F f) const;
+
+   // Builds a new hierarchy on the calling thread and publishes it.
+   void rebuild(point_arr<Traits> const& points);
+   void publish(std::unique_ptr<snapshot_type> snapshot);
+   void reset() { publish(std::unique_ptr<snapshot_type>()); }
+   // Deletes retired snapshots that no reader can see anymore.
+   void reclaim();
+private:
+   static const size_t READER_SLOTS = 64;
+   static constexpr std::chrono::milliseconds RECLAIM_PERIOD{10};
+
+   // 0 means the slot is free, otherwise it holds the epoch its reader
+   // entered in. One slot per cache line so readers do not contend.
+   struct alignas(64) reader_slot {
+      reader_slot(): epoch(0) { }
+      std::atomic<uint64_t> epoch;
+   };
+
+   // new ignores alignas before C++17, so padding on both sides keeps other
+   // allocations off the line of epoch instead.
+   struct overflow_slot {
+      overflow_slot(): epoch(0), next(nullptr) { }
+      char _pad_before[64];
+      std::atomic<uint64_t> epoch;
+      overflow_slot* next;
+      char _pad_after[64];
+   };
+
+   struct read_guard {
+      read_guard(kirkpatrick_handle const&);
+      ~read_guard() { _slot.store(0); }
+      snapshot_type const* snapshot() const { return _snapshot; }
+   private:
+      std::atomic<uint64_t>& _slot;
+      snapshot_type const* _snapshot;
+   };
+
+   // Returns the claimed slot's epoch.
+   std::atomic<uint64_t>& enter() const;
+   void reclaim_loop();
+   // Moves snapshots no reader can see into garbage.
+   void collect_locked(std::vector<snapshot_type*>& garbage);
+private:
+   // Read by every reader, written only by writers.
+   alignas(64) std::atomic<snapshot_type*> _current;
+   std::atomic<uint64_t> _epoch;
+   std::atomic<bool> _retired_pending;
+   mutable reader_slot _slots[READER_SLOTS];
+   mutable std::atomic<overflow_slot*> _overflow_slots;
+
+   std::mutex _write_mutex;
+   // Snapshot with the last epoch readers could have seen it in.
+   std::vector<std::pair<uint64_t, snapshot_type*> > _retired;
+
+   std::atomic<bool> _stopping;
+   std::mutex _reclaim_mutex;
+   std::condition_variable _reclaim_cv;
+   // Last, so that it starts after everything above is initialized.
+   std::thread _reclaimer;
+};
+
+template<class Traits>
+template<class F>
+void kirkpatrick_handle<Traits>::read(F f) const {
+   read_guard guard(*this);
+   f(guard.snapshot());
+}
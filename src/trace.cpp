@@ -0,0 +1,164 @@
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "trace.h"
+
+namespace trace {
+
+namespace detail {
+#ifdef DEBUG
+   std::atomic<unsigned> enabled_categories(all_categories);
+   std::atomic<int> enabled_level(int(level::verbose));
+#else
+   std::atomic<unsigned> enabled_categories(0);
+   std::atomic<int> enabled_level(-1);
+#endif
+}
+
+namespace {
+
+struct event_type {
+   char phase;
+   category cat;
+   std::string name;
+   long long ts;
+   long long dur;
+   unsigned tid;
+   double value;
+};
+
+std::mutex state_mutex;
+#ifdef DEBUG
+std::ostream* text_sink = &std::cerr;
+#else
+std::ostream* text_sink = nullptr;
+#endif
+bool recording = false;
+std::vector<event_type> events;
+
+long long now() {
+   static auto const start = std::chrono::steady_clock::now();
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+         std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned thread_id() {
+   static std::atomic<unsigned> next_id(0);
+   thread_local unsigned id = next_id++;
+   return id;
+}
+
+char const* category_name(category cat) {
+   switch(cat) {
+   case category::build: return "build";
+   case category::query: return "query";
+   case category::graph: return "graph";
+   }
+   return "unknown";
+}
+
+void record(event_type const& e) {
+   std::lock_guard<std::mutex> lock(state_mutex);
+   if(recording) events.push_back(e);
+}
+
+void write_json_string(std::ostream& ost, std::string const& s) {
+   static char const hex[] = "0123456789abcdef";
+   ost << '"';
+   for(char c: s) {
+      switch(c) {
+      case '"': ost << "\\\""; break;
+      case '\\': ost << "\\\\"; break;
+      case '\n': ost << "\\n"; break;
+      case '\t': ost << "\\t"; break;
+      default:
+         if((unsigned char)c < 0x20)
+            ost << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+         else ost << c;
+      }
+   }
+   ost << '"';
+}
+
+}
+
+void enable(unsigned categories, level max_level) {
+   detail::enabled_categories.store(categories, std::memory_order_relaxed);
+   detail::enabled_level.store(int(max_level), std::memory_order_relaxed);
+}
+
+void disable() {
+   detail::enabled_categories.store(0, std::memory_order_relaxed);
+   detail::enabled_level.store(-1, std::memory_order_relaxed);
+}
+
+settings current_settings() {
+   return settings{ detail::enabled_categories.load(std::memory_order_relaxed),
+      detail::enabled_level.load(std::memory_order_relaxed) };
+}
+
+void restore(settings const& s) {
+   detail::enabled_categories.store(s.categories, std::memory_order_relaxed);
+   detail::enabled_level.store(s.max_level, std::memory_order_relaxed);
+}
+
+void set_text_sink(std::ostream* ost) {
+   std::lock_guard<std::mutex> lock(state_mutex);
+   text_sink = ost;
+}
+
+void start_recording() {
+   std::lock_guard<std::mutex> lock(state_mutex);
+   events.clear();
+   recording = true;
+}
+
+void stop_recording() {
+   std::lock_guard<std::mutex> lock(state_mutex);
+   recording = false;
+}
+
+void message(category cat, level, std::string const& msg) {
+   event_type e = { 'i', cat, msg, now(), 0, thread_id(), 0 };
+   std::lock_guard<std::mutex> lock(state_mutex);
+   if(text_sink) *text_sink << "[" << category_name(cat) << "] " << msg << std::endl;
+   if(recording) events.push_back(e);
+}
+
+void counter(category cat, level, char const* name, double value) {
+   record(event_type{ 'C', cat, name, now(), 0, thread_id(), value });
+}
+
+scope<true>::scope(category cat, level lvl, char const* name):
+   _cat(cat), _name(name), _start(0), _active(enabled_at_runtime(cat, lvl)) {
+   if(_active) _start = now();
+}
+
+scope<true>::~scope() {
+   if(!_active) return;
+   long long end = now();
+   record(event_type{ 'X', _cat, _name, _start, end - _start, thread_id(), 0 });
+}
+
+void write_chrome_trace(std::ostream& ost) {
+   std::lock_guard<std::mutex> lock(state_mutex);
+   ost << "{\"traceEvents\":[";
+   for(size_t i = 0; i != events.size(); ++i) {
+      event_type const& e = events[i];
+      if(i != 0) ost << ",";
+      ost << std::endl << "{\"name\":";
+      write_json_string(ost, e.name);
+      ost << ",\"cat\":\"" << category_name(e.cat) << "\",\"ph\":\"" << e.phase
+          << "\",\"ts\":" << e.ts << ",\"pid\":1,\"tid\":" << e.tid;
+      switch(e.phase) {
+      case 'X': ost << ",\"dur\":" << e.dur; break;
+      case 'i': ost << ",\"s\":\"t\""; break;
+      case 'C': ost << ",\"args\":{\"value\":" << e.value << "}"; break;
+      }
+      ost << "}";
+   }
+   ost << std::endl << "]}" << std::endl;
+}
+
+}
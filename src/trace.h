@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Levels compiled in: -1 compiles every trace point out, 0 keeps info,
+// 1 keeps debug and 2 keeps verbose. Trace points above the limit are dead
+// code and their arguments are never evaluated. Release builds keep info,
+// which fires a few times per refine round and costs one relaxed load per
+// point while disabled, so build phases can still be recorded at runtime.
+#ifndef TRACE_MAX_LEVEL
+#ifdef DEBUG
+#define TRACE_MAX_LEVEL 2
+#else
+#define TRACE_MAX_LEVEL 0
+#endif
+#endif
+
+namespace trace {
+
+enum class level { info = 0, debug = 1, verbose = 2 };
+
+enum class category : unsigned { build = 1, query = 2, graph = 4 };
+
+const unsigned all_categories = 7;
+
+namespace detail {
+   extern std::atomic<unsigned> enabled_categories;
+   extern std::atomic<int> enabled_level;
+}
+
+constexpr bool compiled(level lvl) { return int(lvl) <= TRACE_MAX_LEVEL; }
+
+inline bool enabled_at_runtime(category cat, level lvl) {
+   return int(lvl) <= detail::enabled_level.load(std::memory_order_relaxed) &&
+      (unsigned(cat) & detail::enabled_categories.load(std::memory_order_relaxed));
+}
+
+inline bool enabled(category cat, level lvl) {
+   return compiled(lvl) && enabled_at_runtime(cat, lvl);
+}
+
+// Runtime switches. Nothing is enabled by default unless DEBUG is defined,
+// in which case everything compiled in is printed to std::cerr.
+void enable(unsigned categories, level max_level);
+void disable();
+// The current runtime switches, to put them back after a temporary enable.
+struct settings {
+   unsigned categories;
+   int max_level;
+};
+settings current_settings();
+void restore(settings const&);
+// Messages are printed to the text sink, if any. nullptr turns it off.
+void set_text_sink(std::ostream*);
+// While recording, every enabled event is stored for write_chrome_trace.
+void start_recording();
+void stop_recording();
+// Writes recorded events in Chrome trace event format (chrome://tracing).
+void write_chrome_trace(std::ostream&);
+
+void message(category, level, std::string const&);
+void counter(category, level, char const* name, double value);
+
+// Emits a complete event covering the lifetime of the object.
+template<bool Compiled>
+struct scope {
+   scope(category, level, char const*) { }
+};
+
+template<>
+struct scope<true> {
+   scope(category cat, level lvl, char const* name);
+   ~scope();
+   scope(scope const&) = delete;
+   scope& operator=(scope const&) = delete;
+private:
+   category _cat;
+   char const* _name;
+   long long _start;
+   bool _active;
+};
+
+template<class Cont>
+struct joined {
+   Cont const& cont;
+};
+
+// Prints elements of a container separated by spaces.
+template<class Cont>
+joined<Cont> join(Cont const& cont) { return joined<Cont>{cont}; }
+
+template<class Cont>
+std::ostream& operator<<(std::ostream& ost, joined<Cont> const& j) {
+   bool first = true;
+   for(auto const& el: j.cont) {
+      if(!first) ost << " ";
+      ost << el;
+      first = false;
+   }
+   return ost;
+}
+
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+// TRACE(build, debug, "Adding point " << p);
+#define TRACE(cat, lvl, args) \
+   do { \
+      if(::trace::enabled(::trace::category::cat, ::trace::level::lvl)) { \
+         std::ostringstream trace_ost_; \
+         trace_ost_ << args; \
+         ::trace::message(::trace::category::cat, ::trace::level::lvl, \
+               trace_ost_.str()); \
+      } \
+   } while(false)
+
+#define TRACE_COUNTER(cat, lvl, name, value) \
+   do { \
+      if(::trace::enabled(::trace::category::cat, ::trace::level::lvl)) \
+         ::trace::counter(::trace::category::cat, ::trace::level::lvl, name, value); \
+   } while(false)
+
+// name must outlive the trace, i.e. be a string literal.
+#define TRACE_SCOPE(cat, lvl, name) \
+   ::trace::scope< ::trace::compiled(::trace::level::lvl)> \
+      TRACE_CONCAT(trace_scope_, __LINE__)(::trace::category::cat, \
+            ::trace::level::lvl, name)
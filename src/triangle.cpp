@@ -1,34 +1,22 @@
 #include "triangle.h"
 
-bool intersects(triangle_type const& t1, triangle_type const& t2) {
-   segment_arr s1, s2;
-   s1.push_back(segment_type(t1.p1(), t1.p2()));
-   s1.push_back(segment_type(t1.p3(), t1.p2()));
-   s1.push_back(segment_type(t1.p1(), t1.p3()));
-   s2.push_back(segment_type(t2.p1(), t2.p2()));
-   s2.push_back(segment_type(t2.p3(), t2.p2()));
-   s2.push_back(segment_type(t2.p1(), t2.p3()));
-   bool res = false;
-   for(auto x: s1) {
-      for(auto y: s2) {
-         if(intersects(x, y)) res = true;
-      }
-   }
-   return res;
-}
-
-bool triangle_type::inside(point_type const& pt) const {
+template<class Traits>
+bool triangle_type<Traits>::inside(point_type const& pt) const {
    return inside_triangle(_p1, _p2, _p3, pt);
 }
 
-bool triangle_type::query(point_type const& pt) const {
-   logger << "Querying " << pt << " inside " << *this << std::endl;
+template<class Traits>
+bool triangle_type<Traits>::query(point_type const& pt) const {
+   TRACE(query, verbose, "Querying " << pt << " inside " << *this);
    if(!inside(pt)) return false;
-   logger << "Point is inside" << std::endl;
+   TRACE(query, debug, "Point is inside");
    if(_children.empty()) return _is_inside;
-   logger << "Iterating over children" << std::endl;
-   for(auto t: _children) {
+   TRACE(query, debug, "Iterating over children");
+   // No copies of children: refcount traffic would make concurrent readers contend.
+   for(auto const& t: _children) {
       if(t->query(pt)) return true;
    }
    return false;
 }
+
+INSTANTIATE_FOR_COORD_TRAITS(triangle_type)
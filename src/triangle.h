@@ -1,11 +1,20 @@
 #pragma once
 
+#include <memory>
+
 #include "util.h"
 
+template<class Traits>
 struct triangle_type;
-typedef std::shared_ptr<triangle_type> triangle_ptr;
 
+template<class Traits>
+std::ostream& operator<<(std::ostream&, triangle_type<Traits> const&);
+
+template<class Traits>
 struct triangle_type {
+   typedef basic_point<Traits> point_type;
+   typedef std::shared_ptr<triangle_type> triangle_ptr;
+
    triangle_type(point_type const& p1, point_type const& p2, point_type const& p3,
          bool is_inside): _p1(p1), _p2(p2), _p3(p3), _is_inside(is_inside) { }
    bool inside(point_type const& pt) const;
@@ -16,7 +25,7 @@ struct triangle_type {
    point_type const& p1() const { return _p1; }
    point_type const& p2() const { return _p2; }
    point_type const& p3() const { return _p3; }
-   friend std::ostream& operator<<(std::ostream&, triangle_type const&);
+   friend std::ostream& operator<< <>(std::ostream&, triangle_type const&);
 private:
    point_type _p1;
    point_type _p2;
@@ -25,9 +34,24 @@ private:
    bool _is_inside;
 };
 
-bool intersects(triangle_type const& t1, triangle_type const& t2);
+// True if any pair of edges intersects or touches.
+template<class Traits>
+bool intersects(triangle_type<Traits> const& t1, triangle_type<Traits> const& t2) {
+   typedef basic_segment<Traits> segment_type;
+   segment_type const s1[] = { segment_type(t1.p1(), t1.p2()),
+      segment_type(t1.p3(), t1.p2()), segment_type(t1.p1(), t1.p3()) };
+   segment_type const s2[] = { segment_type(t2.p1(), t2.p2()),
+      segment_type(t2.p3(), t2.p2()), segment_type(t2.p1(), t2.p3()) };
+   for(auto const& x: s1) {
+      for(auto const& y: s2) {
+         if(intersects(x, y)) return true;
+      }
+   }
+   return false;
+}
 
-inline std::ostream& operator<<(std::ostream& ost, triangle_type const& t) {
+template<class Traits>
+std::ostream& operator<<(std::ostream& ost, triangle_type<Traits> const& t) {
    ost << "triangle { " << t._p1 << " " << t._p2 << " " << t._p3 << " }: " << std::endl;
    for(auto tr: t._children) {
       ost << "      triangle { " << tr->_p1 << " " << tr->_p2 << " " << tr->_p3 << " }"
@@ -36,7 +60,8 @@ inline std::ostream& operator<<(std::ostream& ost, triangle_type const& t) {
    return ost;
 }
 
+template<class Traits>
 template<class Cont>
-void triangle_type::add_children(Cont const& ts) {
+void triangle_type<Traits>::add_children(Cont const& ts) {
    _children.insert(_children.end(), ts.begin(), ts.end());
 }
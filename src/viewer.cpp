@@ -15,12 +15,16 @@ using namespace visualization;
 kirkpatrick_viewer::kirkpatrick_viewer():
    _state(viewer_state::POLY_INPUT),
    _poly_complete(false),
+   _tracing(false),
+   _trace_before(),
    _query_hit(false) { }
 
 void kirkpatrick_viewer::draw(drawer_type& drawer) const {
    size_t pt_size = 3;
    size_t line_size = 1;
-   if(_kirkpatrick) _kirkpatrick->draw(drawer);
+   _kirkpatrick.read([&drawer](kirkpatrick_type<viewer_traits> const* k) {
+      if(k) k->draw(drawer);
+   });
    if(!_points.empty()) {
       drawer.set_color(Qt::blue);
       auto fst = _points.begin();
@@ -51,13 +55,25 @@ void kirkpatrick_viewer::print(printer_type& printer) const {
    printer.corner_stream() << _status << endl;
 }
 
+basic_point<viewer_traits> to_kirkpatrick(point_type const& pt) {
+   return basic_point<viewer_traits>(pt.x, pt.y);
+}
+
+point_arr<viewer_traits> to_kirkpatrick(std::vector<point_type> const& points) {
+   point_arr<viewer_traits> res;
+   for(auto pt: points) res.push_back(to_kirkpatrick(pt));
+   return res;
+}
+
 bool check_point(point_type const& pt, std::vector<point_type> const& points) {
-   segment_type s(pt, points.back());
+   typedef basic_segment<viewer_traits> segment_type;
+   segment_type s(to_kirkpatrick(pt), to_kirkpatrick(points.back()));
    auto prev = points.begin();
    for(auto it = prev + 1; it != points.end(); prev = it, ++it) {
       if(*it == points.back()) continue;
       if(pt == *it) return false;
-      if(intersects_inside(segment_type(*prev, *it), s)) return false;
+      if(intersects_inside(segment_type(to_kirkpatrick(*prev), to_kirkpatrick(*it)), s))
+         return false;
    }
    return true;
 }
@@ -66,7 +82,7 @@ bool kirkpatrick_viewer::on_double_click(point_type const& pt) {
    switch(_state) {
    case viewer_state::POLY_INPUT: add_point(pt); break;
    case viewer_state::QUERY: _query_point = pt;
-                             _query_hit = _kirkpatrick->query(pt);
+                             _query_hit = _kirkpatrick.query(to_kirkpatrick(pt));
                              break;
    }
    return true;
@@ -78,12 +94,13 @@ bool kirkpatrick_viewer::on_key(int key) {
                        _status = "";
                        _points.clear();
                        _poly_complete = false;
-                       _kirkpatrick = boost::none;
+                       _kirkpatrick.reset();
                        _query_point = boost::none;
                        _query_hit = false;
                        return true;
    case Qt::Key_S: save(); return true;
    case Qt::Key_L: load(); return true;
+   case Qt::Key_T: toggle_trace(); return true;
    default: return false;
    }
 }
@@ -104,9 +121,8 @@ void kirkpatrick_viewer::add_point(point_type const& point) {
       _status = "";
    } else if(distance(_points.front(), point) < dist) {
       _poly_complete = true;
-      _state = viewer_state::QUERY;
-      _kirkpatrick = kirkpatrick_type(_points);
       _status = "";
+      build();
    } else if(check_point(point, _points)) {
       _points.push_back(point);
       _status = "";
@@ -132,14 +148,46 @@ void kirkpatrick_viewer::load() {
    ifs >> _poly_complete;
    _points.assign(std::istream_iterator<point_type>(ifs),
          std::istream_iterator<point_type>());
+   _status = "";
+   _query_point = boost::none;
    if(_poly_complete) {
-      _state = viewer_state::QUERY;
-      _query_point = boost::none;
-      _kirkpatrick = kirkpatrick_type(_points);
+      build();
    } else {
       _state = viewer_state::POLY_INPUT;
-      _query_point = boost::none;
-      _kirkpatrick = boost::none;
+      _kirkpatrick.reset();
+   }
+}
+
+// The polygon stays on screen if the build fails, but there is nothing to query.
+void kirkpatrick_viewer::build() {
+   try {
+      _kirkpatrick.rebuild(to_kirkpatrick(_points));
+      _state = viewer_state::QUERY;
+   } catch(std::exception const& e) {
+      _kirkpatrick.reset();
+      _state = viewer_state::POLY_INPUT;
+      _status = std::string("BUILD FAILED: ") + e.what();
    }
+}
+
+// First press starts recording build and query events, second one saves them
+// as a Chrome trace. Only trace points compiled in by TRACE_MAX_LEVEL show up.
+void kirkpatrick_viewer::toggle_trace() {
+   if(!_tracing) {
+      _trace_before = trace::current_settings();
+      trace::enable(trace::all_categories, trace::level::debug);
+      trace::start_recording();
+      _tracing = true;
+      _status = "Tracing";
+      return;
+   }
+   trace::stop_recording();
+   trace::restore(_trace_before);
+   _tracing = false;
    _status = "";
+   std::string filename =
+      QFileDialog::getSaveFileName(get_wnd(), "Save Trace").toStdString();
+   if(filename.empty()) return;
+   std::ofstream ofs(filename.c_str());
+   trace::write_chrome_trace(ofs);
 }
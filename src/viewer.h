@@ -4,10 +4,13 @@
 
 #include "visualization/viewer_adapter.h"
 
-#include "kirkpatrick.h"
+#include "kirkpatrick_handle.h"
 
 using geom::structures::point_type;
 
+// Screen coordinates of the visualization library are 32-bit integers.
+typedef coord_traits<int32_t> viewer_traits;
+
 struct kirkpatrick_viewer : visualization::viewer_adapter {
    kirkpatrick_viewer();
    void draw(visualization::drawer_type&) const;
@@ -16,15 +19,19 @@ struct kirkpatrick_viewer : visualization::viewer_adapter {
    bool on_key(int key);
 private:
    void add_point(point_type const&);
+   void build();
    void save();
    void load();
+   void toggle_trace();
 private:
    enum class viewer_state { POLY_INPUT, QUERY } _state;
    std::string _status;
    std::vector<point_type> _points;
    bool _poly_complete;
+   bool _tracing;
+   trace::settings _trace_before;
    // QUERY only
-   boost::optional<kirkpatrick_type> _kirkpatrick;
+   kirkpatrick_handle<viewer_traits> _kirkpatrick;
    boost::optional<point_type> _query_point;
    bool _query_hit;
 };